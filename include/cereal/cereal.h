@@ -59,6 +59,14 @@ enum cereal_key_type {
     lowercase
 };
 
+// compress_auto picks the compression from the file extension (.gz, .zst)
+enum cereal_compression_type {
+    compress_auto,
+    compress_none,
+    compress_gzip,
+    compress_zstd
+};
+
 class cereal_init_function {
     std::function<void(const std::any &instance, cereal_base *backend)> _func;
     bool _is_null = false;
@@ -136,6 +144,7 @@ public:
     bool always_save = false;
     cereal_key_type key_type = def;
     cereal_init_function init;
+    cereal_compression_type compression = compress_auto;
 };
 
 // Set by macro
@@ -336,6 +345,10 @@ public:
     }
 
 protected:
+    [[nodiscard]] const cereal_config &config() const {
+        return _config;
+    }
+
     void set_path(const std::filesystem::path &path) {
         _file_path = path;
         _has_file_path = true;
@@ -23,7 +23,7 @@
 
 #include <nlohmann/json.hpp>
 #include <cereal/cereal.h>
-#include <fstream>
+#include <cereal/cereal_stream.h>
 
 template<class T>
 class cereal_json : public cereal<T, cereal_json<T>> {
@@ -53,15 +53,24 @@ public:
 
     void load_file(const std::filesystem::path &path) {
         _cereal_json = nlohmann::json();
-        std::ifstream file(path);
-        if (file)
-            file >> _cereal_json;
+        cereal_ifstream file(path, this->config().compression);
+        if (!file)
+            return;
+
+        file >> _cereal_json;
+        if (file.bad())
+            throw std::runtime_error("Failed to load " + path.string());
     }
 
     void save_file(const std::filesystem::path &path) {
-        std::ofstream file(path);
-        if (file)
-            file << _cereal_json;
+        cereal_ofstream file(path, this->config().compression);
+        if (!file)
+            return;
+
+        file << _cereal_json;
+        file.close();
+        if (!file)
+            throw std::runtime_error("Failed to save " + path.string());
     }
 
     template<class ValueType>
@@ -0,0 +1,328 @@
+/**
+ * File streams used by file backed serialization backends
+ *
+ * Compressed files are (de)compressed while streaming, so the full uncompressed text is never buffered.
+ * Define these (or enable them in cmake) to add support for compressed files
+ * CEREAL_WITH_ZLIB - gzip, requires zlib
+ * CEREAL_WITH_ZSTD - zstd, requires libzstd
+ */
+
+#ifndef CEREAL_STREAM_H
+#define CEREAL_STREAM_H
+
+#include <cereal/cereal.h>
+#include <fstream>
+#include <memory>
+#include <streambuf>
+#include <istream>
+#include <ostream>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+
+#ifdef CEREAL_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef CEREAL_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+inline cereal_compression_type cereal_file_compression(const std::filesystem::path &path,
+                                                       cereal_compression_type compression) {
+    if (compression != compress_auto)
+        return compression;
+
+    auto extension = path.extension();
+    if (extension == ".gz")
+        return compress_gzip;
+    if (extension == ".zst")
+        return compress_zstd;
+    return compress_none;
+}
+
+#ifdef CEREAL_WITH_ZLIB
+
+class cereal_gzip_streambuf : public std::streambuf {
+    gzFile _file = nullptr;
+    std::vector<char> _buffer = std::vector<char>(1 << 16);
+    bool _writing = false;
+
+public:
+    cereal_gzip_streambuf() = default;
+
+    cereal_gzip_streambuf(const cereal_gzip_streambuf &) = delete;
+
+    cereal_gzip_streambuf &operator=(const cereal_gzip_streambuf &) = delete;
+
+    ~cereal_gzip_streambuf() override {
+        close();
+    }
+
+    bool open(const std::filesystem::path &path, std::ios_base::openmode mode) {
+        _writing = (mode & std::ios_base::out) != 0;
+        _file = gzopen(path.string().c_str(), _writing ? "wb" : "rb");
+        if (!_file)
+            return false;
+
+        gzbuffer(_file, (unsigned) _buffer.size());
+        if (_writing)
+            setp(_buffer.data(), _buffer.data() + _buffer.size());
+        else
+            setg(_buffer.data(), _buffer.data(), _buffer.data());
+        return true;
+    }
+
+    bool close() {
+        if (!_file)
+            return true;
+
+        bool ok = !_writing || flush();
+        ok = gzclose(_file) == Z_OK && ok;
+        _file = nullptr;
+        return ok;
+    }
+
+protected:
+    int_type underflow() override {
+        if (gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+        if (!_file || _writing)
+            return traits_type::eof();
+
+        // zlib reports truncated or corrupt data as an error rather than a short read
+        int read = gzread(_file, _buffer.data(), (unsigned) _buffer.size());
+        int error = Z_OK;
+        const char *message = gzerror(_file, &error);
+        if (read < 0 || (error != Z_OK && error != Z_BUF_ERROR) || (read == 0 && error == Z_BUF_ERROR))
+            throw std::runtime_error(std::string("gzip: ") + message);
+        if (read == 0)
+            return traits_type::eof();
+
+        setg(_buffer.data(), _buffer.data(), _buffer.data() + read);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    int_type overflow(int_type ch) override {
+        if (!_file || !_writing || !flush())
+            return traits_type::eof();
+
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override {
+        if (_file && _writing && !flush())
+            return -1;
+        return 0;
+    }
+
+private:
+    bool flush() {
+        auto size = (unsigned) (pptr() - pbase());
+        if (size > 0 && gzwrite(_file, pbase(), size) != (int) size)
+            return false;
+
+        setp(_buffer.data(), _buffer.data() + _buffer.size());
+        return true;
+    }
+};
+
+#endif
+
+#ifdef CEREAL_WITH_ZSTD
+
+class cereal_zstd_streambuf : public std::streambuf {
+    std::filebuf _file;
+    ZSTD_DCtx *_dctx = nullptr;
+    ZSTD_CCtx *_cctx = nullptr;
+    std::vector<char> _in;
+    std::vector<char> _out;
+    ZSTD_inBuffer _in_buffer = { };
+    size_t _remaining = 0;
+
+public:
+    cereal_zstd_streambuf() = default;
+
+    cereal_zstd_streambuf(const cereal_zstd_streambuf &) = delete;
+
+    cereal_zstd_streambuf &operator=(const cereal_zstd_streambuf &) = delete;
+
+    ~cereal_zstd_streambuf() override {
+        close();
+    }
+
+    bool open(const std::filesystem::path &path, std::ios_base::openmode mode) {
+        if (mode & std::ios_base::out) {
+            if (!_file.open(path, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary))
+                return false;
+
+            _cctx = ZSTD_createCCtx();
+            _in.resize(ZSTD_CStreamInSize());
+            _out.resize(ZSTD_CStreamOutSize());
+            setp(_in.data(), _in.data() + _in.size());
+        } else {
+            if (!_file.open(path, std::ios_base::in | std::ios_base::binary))
+                return false;
+
+            _dctx = ZSTD_createDCtx();
+            _in.resize(ZSTD_DStreamInSize());
+            _out.resize(ZSTD_DStreamOutSize());
+            _in_buffer = { _in.data(), 0, 0 };
+            setg(_out.data(), _out.data(), _out.data());
+        }
+        return true;
+    }
+
+    bool close() {
+        bool ok = true;
+        if (_cctx) {
+            ok = compress(ZSTD_e_end);
+            ZSTD_freeCCtx(_cctx);
+            _cctx = nullptr;
+        }
+        if (_dctx) {
+            ZSTD_freeDCtx(_dctx);
+            _dctx = nullptr;
+        }
+        if (_file.is_open())
+            ok = _file.close() && ok;
+        return ok;
+    }
+
+protected:
+    int_type underflow() override {
+        if (gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+        if (!_dctx)
+            return traits_type::eof();
+
+        // A single call may consume input without producing output, so keep going until there is something to read.
+        // At the end of the file the decoder may still hold output, so keep calling it with empty input until it is drained
+        ZSTD_outBuffer out = { _out.data(), _out.size(), 0 };
+        while (out.pos == 0) {
+            bool end = false;
+            if (_in_buffer.pos == _in_buffer.size) {
+                auto read = _file.sgetn(_in.data(), (std::streamsize) _in.size());
+                end = read <= 0;
+                _in_buffer = { _in.data(), end ? 0 : (size_t) read, 0 };
+            }
+
+            // Once a frame is done, a call with empty input returns the header size of the next frame, so only
+            // the result of the last call that made progress says whether the file ended mid frame
+            size_t result = ZSTD_decompressStream(_dctx, &out, &_in_buffer);
+            if (ZSTD_isError(result))
+                throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(result));
+
+            if (end && out.pos == 0) {
+                if (_remaining != 0)
+                    throw std::runtime_error("zstd: unexpected end of file");
+                return traits_type::eof();
+            }
+            _remaining = result;
+        }
+
+        setg(_out.data(), _out.data(), _out.data() + out.pos);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    int_type overflow(int_type ch) override {
+        if (!_cctx || !compress(ZSTD_e_continue))
+            return traits_type::eof();
+
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override {
+        if (_cctx && !compress(ZSTD_e_flush))
+            return -1;
+        return 0;
+    }
+
+private:
+    bool compress(ZSTD_EndDirective mode) {
+        ZSTD_inBuffer in = { pbase(), (size_t) (pptr() - pbase()), 0 };
+        size_t remaining;
+        do {
+            ZSTD_outBuffer out = { _out.data(), _out.size(), 0 };
+            remaining = ZSTD_compressStream2(_cctx, &out, &in, mode);
+            if (ZSTD_isError(remaining))
+                return false;
+            if (_file.sputn(_out.data(), (std::streamsize) out.pos) != (std::streamsize) out.pos)
+                return false;
+        } while (mode == ZSTD_e_continue ? in.pos < in.size : remaining != 0);
+
+        setp(_in.data(), _in.data() + _in.size());
+        return true;
+    }
+};
+
+#endif
+
+/**
+ * Opens a file through the streambuf matching its compression, and exposes it as a regular stream
+ */
+template<class StreamType, std::ios_base::openmode Mode>
+class cereal_basic_fstream : public StreamType {
+    std::unique_ptr<std::streambuf> _buf;
+    std::function<bool()> _close;
+
+public:
+    cereal_basic_fstream(const std::filesystem::path &path, cereal_compression_type compression)
+            : StreamType(nullptr) {
+        switch (cereal_file_compression(path, compression)) {
+            case compress_gzip:
+#ifdef CEREAL_WITH_ZLIB
+                open<cereal_gzip_streambuf>(path);
+                break;
+#else
+                throw std::runtime_error("gzip support is not enabled, define CEREAL_WITH_ZLIB to open " + path.string());
+#endif
+            case compress_zstd:
+#ifdef CEREAL_WITH_ZSTD
+                open<cereal_zstd_streambuf>(path);
+                break;
+#else
+                throw std::runtime_error("zstd support is not enabled, define CEREAL_WITH_ZSTD to open " + path.string());
+#endif
+            default:
+                open<std::filebuf>(path);
+                break;
+        }
+    }
+
+    // Compressed files are only complete once closed, so check the stream afterwards instead of relying on the destructor
+    void close() {
+        if (!_close)
+            return;
+        if (!_close())
+            this->setstate(std::ios_base::failbit);
+        _close = nullptr;
+    }
+
+private:
+    template<class BufType>
+    void open(const std::filesystem::path &path) {
+        auto buf = std::make_unique<BufType>();
+        if (!buf->open(path, Mode)) {
+            this->setstate(std::ios_base::failbit);
+            return;
+        }
+
+        _close = [buf = buf.get()]() { return (bool) buf->close(); };
+        _buf = std::move(buf);
+        this->rdbuf(_buf.get());
+    }
+};
+
+using cereal_ifstream = cereal_basic_fstream<std::istream, std::ios_base::in>;
+using cereal_ofstream = cereal_basic_fstream<std::ostream, std::ios_base::out | std::ios_base::trunc>;
+
+#endif
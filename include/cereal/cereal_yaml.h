@@ -32,7 +32,7 @@
 
 #include <yaml-cpp/yaml.h>
 #include <cereal/cereal.h>
-#include <fstream>
+#include <cereal/cereal_stream.h>
 
 template<class T>
 class cereal_yaml: public cereal<T, cereal_yaml<T>> {
@@ -56,13 +56,23 @@ public:
     }
 
     void load_file(const std::filesystem::path &path) {
-        _cereal_yaml = YAML::LoadFile(path.string());
+        cereal_ifstream file(path, this->config().compression);
+        if (!file)
+            throw YAML::BadFile(path.string());
+        _cereal_yaml = YAML::Load(file);
+        if (file.bad())
+            throw std::runtime_error("Failed to load " + path.string());
     }
 
     void save_file(const std::filesystem::path &path) {
-        std::ofstream file(path);
-        if (file)
-            file << _cereal_yaml;
+        cereal_ofstream file(path, this->config().compression);
+        if (!file)
+            return;
+
+        file << _cereal_yaml;
+        file.close();
+        if (!file)
+            throw std::runtime_error("Failed to save " + path.string());
     }
 
     template<class ValueType>